@@ -2,6 +2,7 @@
 
 
 #include "FiveFunctionLibrary.h"
+#include "PlanetTextureCache.h"
 
 #include "Engine/Texture2D.h"
 #include "Engine/TextureCube.h"
@@ -38,9 +39,81 @@ inline auto& GetVoxelTextureTypeMap()
 	return Map;
 }
 
+// TextureKey + channel
+inline auto& GetBiomeTextureMap()
+{
+	check(IsInGameThread());
+	static TMap<TPair<FString, uint8>, TVoxelSharedPtr<FPlanetBiomeTextureData>> Map;
+	return Map;
+}
+
+inline void RemoveBiomeTextures(const FString& TextureKey)
+{
+	for (const EVoxelRGBA Channel : { EVoxelRGBA::R, EVoxelRGBA::G, EVoxelRGBA::B, EVoxelRGBA::A })
+	{
+		GetBiomeTextureMap().Remove(MakeTuple(TextureKey, uint8(Channel)));
+	}
+}
+
+// Content-hash deduplication, identical data inserted under different keys shares one copy
+
+using FColourTextureData = TVoxelTexture<FColor>::FTextureData;
+using FFloatTextureData = TVoxelTexture<float>::FTextureData;
+
+template<typename TData>
+inline auto& GetContentPool()
+{
+	check(IsInGameThread());
+	static TPlanetTextureContentPool<TData> Pool;
+	return Pool;
+}
+
+struct FChannelConversion
+{
+	TVoxelWeakPtr<FColourTextureData> Source;
+	TVoxelWeakPtr<FFloatTextureData> Result;
+};
+
+// Source colour data + channel -> converted float data, so deduplicated sources are only converted once
+inline auto& GetChannelConversionMap()
+{
+	check(IsInGameThread());
+	static TMap<TPair<const FColourTextureData*, uint8>, FChannelConversion> Map;
+	return Map;
+}
+
+inline void ForgetChannelConversion(const TVoxelSharedRef<FFloatTextureData>& Result)
+{
+	for (auto It = GetChannelConversionMap().CreateIterator(); It; ++It)
+	{
+		const TVoxelSharedPtr<FFloatTextureData> Existing = It.Value().Result.Pin();
+		if (!Existing.IsValid() || Existing == Result)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+inline uint8 GetColourChannel(const FColor& Color, EVoxelRGBA Channel)
+{
+	switch (Channel)
+	{
+	case EVoxelRGBA::R:
+		return Color.R;
+	case EVoxelRGBA::G:
+		return Color.G;
+	case EVoxelRGBA::B:
+		return Color.B;
+	case EVoxelRGBA::A:
+		return Color.A;
+	}
+	return 0;
+}
+
 // ref: VoxelPlugin ; VoxelTexture.cpp
 
-inline void ExtractTextureData(UTexture* Texture, int32& OutSizeX, int32& OutSizeY, TArray<FColor>& OutData)
+// Returns false (and a 1x1 texture) if the texture couldn't be read
+inline bool ExtractTextureData(UTexture* Texture, int32& OutSizeX, int32& OutSizeY, TArray<FColor>& OutData)
 {
 	VOXEL_FUNCTION_COUNTER();
 
@@ -61,7 +134,7 @@ inline void ExtractTextureData(UTexture* Texture, int32& OutSizeX, int32& OutSiz
 			OutSizeX = 1;
 			OutSizeY = 1;
 			OutData.SetNum(1);
-			return;
+			return false;
 		}
 
 		void* Data = BulkData.Lock(LOCK_READ_ONLY);
@@ -71,12 +144,12 @@ inline void ExtractTextureData(UTexture* Texture, int32& OutSizeX, int32& OutSiz
 			OutSizeX = 1;
 			OutSizeY = 1;
 			OutData.SetNum(1);
-			return;
+			return false;
 		}
 
 		FMemory::Memcpy(OutData.GetData(), Data, Size * sizeof(FColor));
 		Mip.BulkData.Unlock();
-		return;
+		return true;
 	}
 
 	if (auto* TextureRenderTarget = Cast<UTextureRenderTarget2D>(Texture))
@@ -96,12 +169,12 @@ inline void ExtractTextureData(UTexture* Texture, int32& OutSizeX, int32& OutSiz
 			{
 			case PF_B8G8R8A8:
 			{
-				if (ensure(RenderTarget->ReadPixels(OutData))) return;
+				if (ensure(RenderTarget->ReadPixels(OutData))) return true;
 				break;
 			}
 			case PF_R8G8B8A8:
 			{
-				if (ensure(RenderTarget->ReadPixels(OutData))) return;
+				if (ensure(RenderTarget->ReadPixels(OutData))) return true;
 				break;
 			}
 			case PF_FloatRGBA:
@@ -114,7 +187,7 @@ inline void ExtractTextureData(UTexture* Texture, int32& OutSizeX, int32& OutSiz
 					{
 						OutData[Index] = LinearColors[Index].ToFColor(false);
 					}
-					return;
+					return true;
 				}
 				break;
 			}
@@ -128,9 +201,10 @@ inline void ExtractTextureData(UTexture* Texture, int32& OutSizeX, int32& OutSiz
 	OutSizeX = 1;
 	OutSizeY = 1;
 	OutData.SetNum(1);
+	return false;
 }
 
-TVoxelTexture<FColor> CreateVoxelTexture_Colour(UTexture* Texture, FString& TextureKey)
+TVoxelSharedRef<FColourTextureData> CreateVoxelTexture_Colour(UTexture* Texture, FString& TextureKey)
 {
 	auto& Data = GetVoxelTextureTypeMap<FColor>().FindOrAdd(TextureKey);
 	if (!Data.IsValid())
@@ -140,14 +214,28 @@ TVoxelTexture<FColor> CreateVoxelTexture_Colour(UTexture* Texture, FString& Text
 		TArray<FColor>TextureData;
 		ExtractTextureData(Texture, SizeX, SizeY, TextureData);
 
-		Data = MakeVoxelShared<TVoxelTexture<FColor>::FTextureData>();
-		Data->SetSize(SizeX, SizeY);
-		for (int32 Index = 0; Index < SizeX * SizeY; ++Index)
+		Data = GetContentPool<FColourTextureData>().FindOrAdd(UFiveFunctionLibrary::MakeColourTextureData(SizeX, SizeY, TextureData));
+	}
+	return Data.ToSharedRef();
+}
+
+// Converts pooled colour data once per channel, Convert is only called on a miss and returns pooled data
+template<typename TConvert>
+TVoxelSharedRef<FFloatTextureData> FindOrAddChannelConversion(const TVoxelSharedRef<FColourTextureData>& ColorTexture, EVoxelRGBA Channel, TConvert&& Convert)
+{
+	FChannelConversion& Conversion = GetChannelConversionMap().FindOrAdd(MakeTuple(&ColorTexture.Get(), uint8(Channel)));
+	if (Conversion.Source.Pin() == ColorTexture)
+	{
+		if (const TVoxelSharedPtr<FFloatTextureData> Converted = Conversion.Result.Pin())
 		{
-			Data->SetValue(Index, TextureData[Index]);
+			return Converted.ToSharedRef();
 		}
 	}
-	return TVoxelTexture<FColor>(Data.ToSharedRef());
+
+	const TVoxelSharedRef<FFloatTextureData> Data = Convert();
+	Conversion.Source = ColorTexture;
+	Conversion.Result = Data;
+	return Data;
 }
 
 FVoxelFloatTexture UFiveFunctionLibrary::CreateVoxelFloatTextureFromRenderTargetChannel(UObject* WorldContext, FPlanetResource Resource, EVoxelRGBA Channel, int MipLevel)
@@ -162,45 +250,203 @@ FVoxelFloatTexture UFiveFunctionLibrary::CreateVoxelFloatTextureFromRenderTarget
 	}
 	
 	const auto ColorTexture = CreateVoxelTexture_Colour(RT, Resource.TextureKey);
+	Data = FindOrAddChannelConversion(ColorTexture, Channel, [&]()
+	{
+		return GetContentPool<FFloatTextureData>().FindOrAdd(ConvertColourChannelToFloat(*ColorTexture, Channel));
+	});
 
-	
-	Data = MakeVoxelShared<TVoxelTexture<float>::FTextureData>();
-	Data->SetSize(ColorTexture.GetSizeX(), ColorTexture.GetSizeY());
+	return TVoxelTexture<float>(Data.ToSharedRef());
+}
 
-	const int32 Num = ColorTexture.GetSizeX() * ColorTexture.GetSizeY();
-	const int32 Width = ColorTexture.GetSizeX();
-	const int32 Height = ColorTexture.GetSizeY();
-	for (int32 X = 0; X < Width; X++)
+bool UFiveFunctionLibrary::ReadRenderTargetPixels(FPlanetResource Resource, int32& OutSizeX, int32& OutSizeY, TArray<FColor>& OutData)
+{
+	FPlanetResourceKey* RTData = GetRenderTargetMap().Find(Resource.TextureKey);
+	if (!RTData || !RTData->bValid || !RTData->Value)
 	{
-		for (int32 Y = 0; Y < Height; Y++)
+		return false;
+	}
+	return ExtractTextureData(RTData->Value, OutSizeX, OutSizeY, OutData);
+}
+
+TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData> UFiveFunctionLibrary::MakeColourTextureData(int32 SizeX, int32 SizeY, const TArray<FColor>& Pixels)
+{
+	const auto Data = MakeVoxelShared<FColourTextureData>();
+	Data->SetSize(SizeX, SizeY);
+	for (int32 Index = 0; Index < SizeX * SizeY; ++Index)
+	{
+		Data->SetValue(Index, Pixels[Index]);
+	}
+	return Data;
+}
+
+TVoxelSharedRef<TVoxelTexture<float>::FTextureData> UFiveFunctionLibrary::ConvertColourChannelToFloat(const TVoxelTexture<FColor>::FTextureData& Colours, EVoxelRGBA Channel)
+{
+	const auto Data = MakeVoxelShared<FFloatTextureData>();
+	Data->SetSize(Colours.GetSizeX(), Colours.GetSizeY());
+
+	const TArray<FColor>& Pixels = Colours.GetTextureData();
+	for (int32 Index = 0; Index < Pixels.Num(); Index++)
+	{
+		const uint8 Result = GetColourChannel(Pixels[Index], Channel);
+		const float Value = FVoxelUtilities::UINT8ToFloat(Result);
+		Data->SetValue(Index, Value);
+	}
+	return Data;
+}
+
+TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData> UFiveFunctionLibrary::PoolColourTextureData(const TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData>& Colours, uint64 Hash)
+{
+	return GetContentPool<FColourTextureData>().FindOrAdd(Colours, Hash);
+}
+
+TVoxelSharedPtr<TVoxelTexture<float>::FTextureData> UFiveFunctionLibrary::FindChannelConversion(const TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData>& Colours, EVoxelRGBA Channel)
+{
+	const FChannelConversion* Conversion = GetChannelConversionMap().Find(MakeTuple(&Colours.Get(), uint8(Channel)));
+	if (Conversion && Conversion->Source.Pin() == Colours)
+	{
+		return Conversion->Result.Pin();
+	}
+	return nullptr;
+}
+
+FVoxelFloatTexture UFiveFunctionLibrary::RegisterVoxelTextureData(FPlanetResource Resource, EVoxelRGBA Channel, const TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData>& Colours, const TVoxelSharedRef<TVoxelTexture<float>::FTextureData>& Floats, uint64 FloatsHash)
+{
+	GetVoxelTextureTypeMap<FColor>().Add(Resource.TextureKey, Colours);
+
+	// A planet identical to an already registered one reuses its conversion and drops the new one
+	const auto Data = FindOrAddChannelConversion(Colours, Channel, [&]() { return GetContentPool<FFloatTextureData>().FindOrAdd(Floats, FloatsHash); });
+	GetVoxelTextureTypeMap<float>().Add(Resource.TextureKey, Data);
+	// Built from the previous render target
+	RemoveBiomeTextures(Resource.TextureKey);
+
+	return TVoxelTexture<float>(Data);
+}
+
+// Copy-on-write edit of the float data cached for TextureKey, CanEdit validates the request against the data before anything is copied
+template<typename TCanEdit, typename TEdit>
+FVoxelFloatTexture EditVoxelFloatTexture(const FString& TextureKey, bool& bSuccess, TCanEdit&& CanEdit, TEdit&& Edit)
+{
+	bSuccess = false;
+	auto* Slot = GetVoxelTextureTypeMap<float>().Find(TextureKey);
+	if (!Slot || !Slot->IsValid())
+	{
+		return FVoxelFloatTexture();
+	}
+	if (!CanEdit(**Slot))
+	{
+		return TVoxelTexture<float>(Slot->ToSharedRef());
+	}
+
+	// Other planets may share this data, copy it before the edit if so
+	bool bRemovedFromPool = false;
+	const auto Data = GetContentPool<FFloatTextureData>().MakeUnique(*Slot, bRemovedFromPool);
+	if (bRemovedFromPool)
+	{
+		// Only pooled data is a conversion result, and only until its first edit
+		ForgetChannelConversion(Data);
+	}
+	Edit(*Data);
+
+	bSuccess = true;
+	return TVoxelTexture<float>(Data);
+}
+
+FVoxelFloatTexture UFiveFunctionLibrary::SetVoxelFloatTextureValue(FPlanetResource Resource, int32 X, int32 Y, float Value, bool& bSuccess)
+{
+	return EditVoxelFloatTexture(Resource.TextureKey, bSuccess,
+		[&](const FFloatTextureData& Data) { return X >= 0 && Y >= 0 && X < Data.GetSizeX() && Y < Data.GetSizeY(); },
+		[&](FFloatTextureData& Data) { Data.SetValue(Y * Data.GetSizeX() + X, Value); });
+}
+
+FVoxelFloatTexture UFiveFunctionLibrary::SetVoxelFloatTextureValues(FPlanetResource Resource, const TArray<FIntPoint>& Texels, const TArray<float>& Values, bool& bSuccess)
+{
+	return EditVoxelFloatTexture(Resource.TextureKey, bSuccess,
+		[&](const FFloatTextureData& Data)
 		{
-			int32 Index = Y * Width + X;
-			const FColor Color = ColorTexture.GetTextureData()[Index];
-			uint8 Result = 0;
-			switch (Channel)
+			return Texels.Num() == Values.Num() && !Texels.ContainsByPredicate([&](const FIntPoint& Texel)
 			{
-			case EVoxelRGBA::R:
-				Result = Color.R;
-				break;
-			case EVoxelRGBA::G:
-				Result = Color.G;
-				break;
-			case EVoxelRGBA::B:
-				Result = Color.B;
-				break;
-			case EVoxelRGBA::A:
-				Result = Color.A;
-				break;
+				return Texel.X < 0 || Texel.Y < 0 || Texel.X >= Data.GetSizeX() || Texel.Y >= Data.GetSizeY();
+			});
+		},
+		[&](FFloatTextureData& Data)
+		{
+			for (int32 Index = 0; Index < Texels.Num(); Index++)
+			{
+				Data.SetValue(Texels[Index].Y * Data.GetSizeX() + Texels[Index].X, Values[Index]);
 			}
-			const float Value = FVoxelUtilities::UINT8ToFloat(Result);
-			Data->SetValue(Index, Value);
-		}
+		});
+}
+
+FPlanetBiomeTexture UFiveFunctionLibrary::CreateBiomeTextureFromRenderTargetChannel(UObject* WorldContext, FPlanetResource Resource, EVoxelRGBA Channel, const TArray<FPlanetBiome>& Palette, bool bComputeEdgeDistance, int32 MaxEdgeDistance)
+{
+	FPlanetResourceKey* RTData = GetRenderTargetMap().Find(Resource.TextureKey);
+	if (!RTData || !RTData->bValid)
+	{
+		return FPlanetBiomeTexture();
 	}
 
-	
-	
+	// Cached data is shared, a different palette or edge setting builds a new texture instead of editing it
+	auto& Data = GetBiomeTextureMap().FindOrAdd(MakeTuple(Resource.TextureKey, uint8(Channel)));
+	if (Data && Data->GetPalette() == Palette &&
+		(bComputeEdgeDistance ? Data->GetMaxEdgeDistance() == FMath::Clamp(MaxEdgeDistance, 1, 255) : !Data->HasEdgeDistance()))
+	{
+		return FPlanetBiomeTexture(Data.ToSharedRef());
+	}
 
-	return TVoxelTexture<float>(Data.ToSharedRef());
+	// Shares the readback (and its cache entry) with the float textures of the same resource.
+	const auto ColorTexture = CreateVoxelTexture_Colour(RTData->Value, Resource.TextureKey);
+
+	Data = MakeVoxelShared<FPlanetBiomeTextureData>();
+	Data->SetSize(ColorTexture->GetSizeX(), ColorTexture->GetSizeY());
+	Data->SetPalette(Palette);
+
+	const TArray<FColor>& Colours = ColorTexture->GetTextureData();
+	for (int32 Index = 0; Index < Colours.Num(); Index++)
+	{
+		Data->SetIndex(Index, GetColourChannel(Colours[Index], Channel));
+	}
+
+	if (bComputeEdgeDistance)
+	{
+		Data->ComputeEdgeDistance(MaxEdgeDistance);
+	}
+	Data = GetContentPool<FPlanetBiomeTextureData>().FindOrAdd(Data.ToSharedRef());
+
+	return FPlanetBiomeTexture(Data.ToSharedRef());
+}
+
+int32 UFiveFunctionLibrary::SampleBiomeNearest(const FPlanetBiomeTexture& Texture, float U, float V, FPlanetBiome& Biome, bool& bSuccess)
+{
+	bSuccess = false;
+	if (!Texture.IsValid()) return -1;
+
+	const uint8 Index = Texture.GetData()->SampleNearest(U, V);
+	if (const FPlanetBiome* Found = Texture.GetData()->GetBiome(Index))
+	{
+		Biome = *Found;
+		bSuccess = true;
+	}
+	return Index;
+}
+
+int32 UFiveFunctionLibrary::SampleBiomeMajority(const FPlanetBiomeTexture& Texture, float U, float V, int32 Radius, FPlanetBiome& Biome, bool& bSuccess)
+{
+	bSuccess = false;
+	if (!Texture.IsValid()) return -1;
+
+	const uint8 Index = Texture.GetData()->SampleMajority(U, V, Radius);
+	if (const FPlanetBiome* Found = Texture.GetData()->GetBiome(Index))
+	{
+		Biome = *Found;
+		bSuccess = true;
+	}
+	return Index;
+}
+
+float UFiveFunctionLibrary::SampleBiomeEdgeDistance(const FPlanetBiomeTexture& Texture, float U, float V)
+{
+	if (!Texture.IsValid()) return 1.f;
+	return Texture.GetData()->SampleEdgeDistance(U, V);
 }
 
 UTextureRenderTargetCube* UFiveFunctionLibrary::CreateRenderTargetCube(UObject* WorldContext, int32 Width, TextureMipGenSettings MipSettings, FLinearColor ClearColor, TextureCompressionSettings CompressionSettings, bool bHDR, FString TextureKey)
@@ -276,6 +522,13 @@ void UFiveFunctionLibrary::ClearCache(bool bRenderTargetsOnly, bool bVoxelTextur
 		}
 		
 		GetVoxelTextureMap().Empty();
+		GetVoxelTextureTypeMap<FColor>().Empty();
+		GetVoxelTextureTypeMap<float>().Empty();
+		GetBiomeTextureMap().Empty();
+		GetChannelConversionMap().Empty();
+		GetContentPool<FColourTextureData>().Empty();
+		GetContentPool<FFloatTextureData>().Empty();
+		GetContentPool<FPlanetBiomeTextureData>().Empty();
 	}
 
 	if (bRenderTargetsOnly || (!bRenderTargetsOnly && !bVoxelTexturesOnly))
@@ -332,6 +585,31 @@ FPlanetResource UFiveFunctionLibrary::CreatePlanetResource(UObject* WorldContext
 	return Resource;
 }
 
+TVoxelSharedPtr<TVoxelTexture<float>::FTextureData> UFiveFunctionLibrary::GetCachedFloatTextureData(const FString& TextureKey)
+{
+	return GetVoxelTextureTypeMap<float>().FindRef(TextureKey);
+}
+
+void UFiveFunctionLibrary::DiscardPlanetResource(FPlanetResource Resource, bool bDiscardCubemap)
+{
+	TArray<FString, TInlineAllocator<2>> Keys = { Resource.TextureKey };
+	if (bDiscardCubemap)
+	{
+		Keys.Add(Resource.CubemapKey);
+	}
+	for (const FString& Key : Keys)
+	{
+		FPlanetResourceKey RT;
+		if (GetRenderTargetMap().RemoveAndCopyValue(Key, RT) && RT.bValid && RT.Value)
+		{
+			RT.Value->ReleaseResource();
+		}
+	}
+	GetVoxelTextureTypeMap<FColor>().Remove(Resource.TextureKey);
+	GetVoxelTextureTypeMap<float>().Remove(Resource.TextureKey);
+	RemoveBiomeTextures(Resource.TextureKey);
+}
+
 void UFiveFunctionLibrary::ReleasePlanetResource(FPlanetResource Resource)
 {
 	FPlanetResourceKey* RT = GetRenderTargetMap().Find(Resource.TextureKey);
@@ -344,6 +622,7 @@ void UFiveFunctionLibrary::ReleasePlanetResource(FPlanetResource Resource)
 	if (Data) {
 		Data->Reset();
 	}
+	RemoveBiomeTextures(Resource.TextureKey);
 	FPlanetResourceKey* RTCube = GetRenderTargetMap().Find(Resource.CubemapKey);
 	if (RTCube)
 	{
@@ -0,0 +1,133 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+
+#include "PlanetBiomeTexture.h"
+
+void FPlanetBiomeTextureData::SetSize(int32 NewSizeX, int32 NewSizeY)
+{
+	check(NewSizeX > 0 && NewSizeY > 0);
+	SizeX = NewSizeX;
+	SizeY = NewSizeY;
+	Indices.SetNumZeroed(SizeX * SizeY);
+	EdgeDistances.Empty();
+	MaxEdgeDistance = 0;
+}
+
+void FPlanetBiomeTextureData::ComputeEdgeDistance(int32 MaxDistance)
+{
+	MaxEdgeDistance = FMath::Clamp(MaxDistance, 1, 255);
+
+	// 3-4 chamfer distance transform. X wraps like the samplers do, so borders crossing the seam blend too.
+	constexpr int32 Orthogonal = 3;
+	constexpr int32 Diagonal = 4;
+	const int32 Infinity = (MaxEdgeDistance + 1) * Orthogonal;
+
+	TArray<int32> Distances;
+	Distances.SetNumUninitialized(SizeX * SizeY);
+	for (int32 Y = 0; Y < SizeY; Y++)
+	{
+		for (int32 X = 0; X < SizeX; X++)
+		{
+			const int32 Index = Y * SizeX + X;
+			const uint8 Value = Indices[Index];
+			const bool bEdge =
+				Indices[GetTexelIndex(X - 1, Y)] != Value ||
+				Indices[GetTexelIndex(X + 1, Y)] != Value ||
+				(Y > 0 && Indices[Index - SizeX] != Value) ||
+				(Y < SizeY - 1 && Indices[Index + SizeX] != Value);
+			Distances[Index] = bEdge ? 0 : Infinity;
+		}
+	}
+
+	const auto Relax = [&](int32 Index, int32 X, int32 Y, int32 Weight)
+	{
+		if (Y >= 0 && Y < SizeY)
+		{
+			Distances[Index] = FMath::Min(Distances[Index], Distances[GetTexelIndex(X, Y)] + Weight);
+		}
+	};
+
+	// The wrapped neighbours of the first/last column are only up to date after a full forward + backward pass,
+	// a second round carries the distances across the seam.
+	for (int32 Pass = 0; Pass < 2; Pass++)
+	{
+		for (int32 Y = 0; Y < SizeY; Y++)
+		{
+			for (int32 X = 0; X < SizeX; X++)
+			{
+				const int32 Index = Y * SizeX + X;
+				Relax(Index, X - 1, Y, Orthogonal);
+				Relax(Index, X, Y - 1, Orthogonal);
+				Relax(Index, X - 1, Y - 1, Diagonal);
+				Relax(Index, X + 1, Y - 1, Diagonal);
+			}
+		}
+		for (int32 Y = SizeY - 1; Y >= 0; Y--)
+		{
+			for (int32 X = SizeX - 1; X >= 0; X--)
+			{
+				const int32 Index = Y * SizeX + X;
+				Relax(Index, X + 1, Y, Orthogonal);
+				Relax(Index, X, Y + 1, Orthogonal);
+				Relax(Index, X + 1, Y + 1, Diagonal);
+				Relax(Index, X - 1, Y + 1, Diagonal);
+			}
+		}
+	}
+
+	EdgeDistances.SetNumUninitialized(SizeX * SizeY);
+	for (int32 Index = 0; Index < SizeX * SizeY; Index++)
+	{
+		EdgeDistances[Index] = uint8(FMath::Min((Distances[Index] + Orthogonal / 2) / Orthogonal, MaxEdgeDistance));
+	}
+}
+
+uint8 FPlanetBiomeTextureData::SampleNearest(float U, float V) const
+{
+	if (Indices.Num() == 0) return 0;
+
+	int32 X, Y;
+	UVToTexel(U, V, X, Y);
+	return Indices[GetTexelIndex(X, Y)];
+}
+
+uint8 FPlanetBiomeTextureData::SampleMajority(float U, float V, int32 Radius) const
+{
+	if (Indices.Num() == 0) return 0;
+
+	int32 CenterX, CenterY;
+	UVToTexel(U, V, CenterX, CenterY);
+	const uint8 Center = Indices[GetTexelIndex(CenterX, CenterY)];
+
+	Radius = FMath::Clamp(Radius, 0, 8);
+	if (Radius == 0) return Center;
+
+	int32 Counts[256] = {};
+	for (int32 Y = CenterY - Radius; Y <= CenterY + Radius; Y++)
+	{
+		for (int32 X = CenterX - Radius; X <= CenterX + Radius; X++)
+		{
+			Counts[Indices[GetTexelIndex(X, Y)]]++;
+		}
+	}
+
+	// Ties keep the centre texel so borders don't jitter between equally common biomes.
+	uint8 Result = Center;
+	for (int32 Index = 0; Index < 256; Index++)
+	{
+		if (Counts[Index] > Counts[Result])
+		{
+			Result = uint8(Index);
+		}
+	}
+	return Result;
+}
+
+float FPlanetBiomeTextureData::SampleEdgeDistance(float U, float V) const
+{
+	if (!HasEdgeDistance()) return 1.f;
+
+	int32 X, Y;
+	UVToTexel(U, V, X, Y);
+	return float(EdgeDistances[GetTexelIndex(X, Y)]) / MaxEdgeDistance;
+}
@@ -0,0 +1,101 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+
+#include "PlanetBiomeTexture.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static FPlanetBiomeTextureData MakeBiomeTestTexture(int32 SizeX, int32 SizeY, const TArray<uint8>& Indices)
+{
+	check(Indices.Num() == SizeX * SizeY);
+	FPlanetBiomeTextureData Data;
+	Data.SetSize(SizeX, SizeY);
+	for (int32 Index = 0; Index < Indices.Num(); Index++)
+	{
+		Data.SetIndex(Index, Indices[Index]);
+	}
+	return Data;
+}
+
+// UV at the centre of a texel
+static float TexelCentre(int32 Texel, int32 Size)
+{
+	return (Texel + 0.5f) / Size;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlanetBiomeTextureMajorityTest, "Cubemapping01.PlanetBiomeTexture.Majority", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPlanetBiomeTextureMajorityTest::RunTest(const FString& Parameters)
+{
+	// Three biomes with three texels each around a centre of biome 1
+	const FPlanetBiomeTextureData Tie = MakeBiomeTestTexture(3, 3,
+	{
+		2, 3, 1,
+		2, 1, 3,
+		3, 2, 1
+	});
+	TestEqual(TEXT("Ties keep the centre texel"), int32(Tie.SampleMajority(0.5f, 0.5f, 1)), 1);
+	TestEqual(TEXT("Radius 0 is nearest"), int32(Tie.SampleMajority(0.5f, 0.5f, 0)), 1);
+
+	const FPlanetBiomeTextureData Majority = MakeBiomeTestTexture(3, 3,
+	{
+		2, 2, 1,
+		2, 1, 3,
+		3, 2, 1
+	});
+	TestEqual(TEXT("Most common biome wins"), int32(Majority.SampleMajority(0.5f, 0.5f, 1)), 2);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlanetBiomeTextureWrapTest, "Cubemapping01.PlanetBiomeTexture.Wrap", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPlanetBiomeTextureWrapTest::RunTest(const FString& Parameters)
+{
+	const FPlanetBiomeTextureData Data = MakeBiomeTestTexture(4, 2,
+	{
+		0, 1, 2, 3,
+		4, 5, 6, 7
+	});
+
+	TestEqual(TEXT("Inside"), int32(Data.SampleNearest(TexelCentre(2, 4), TexelCentre(1, 2))), 6);
+	TestEqual(TEXT("U below 0 wraps to the last column"), int32(Data.SampleNearest(TexelCentre(-1, 4), TexelCentre(0, 2))), 3);
+	TestEqual(TEXT("U above 1 wraps to the first column"), int32(Data.SampleNearest(TexelCentre(4, 4), TexelCentre(1, 2))), 4);
+	TestEqual(TEXT("V below 0 clamps to the first row"), int32(Data.SampleNearest(TexelCentre(1, 4), -1.f)), 1);
+	TestEqual(TEXT("V above 1 clamps to the last row"), int32(Data.SampleNearest(TexelCentre(1, 4), 2.f)), 5);
+
+	// The window around the first column wraps around to the last one: three texels each of 3, 0 and 1, so the centre wins
+	const FPlanetBiomeTextureData Seam = MakeBiomeTestTexture(4, 1, { 0, 1, 2, 3 });
+	TestEqual(TEXT("Majority window wraps horizontally"), int32(Seam.SampleMajority(TexelCentre(0, 4), 0.5f, 1)), 0);
+	const FPlanetBiomeTextureData SeamMajority = MakeBiomeTestTexture(4, 1, { 0, 3, 2, 3 });
+	TestEqual(TEXT("Majority counts texels across the seam"), int32(SeamMajority.SampleMajority(TexelCentre(0, 4), 0.5f, 1)), 3);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlanetBiomeTextureEdgeDistanceTest, "Cubemapping01.PlanetBiomeTexture.EdgeDistance", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPlanetBiomeTextureEdgeDistanceTest::RunTest(const FString& Parameters)
+{
+	// Biome 1 on the left half, 0 on the right, so one border is in the middle and the other one crosses the seam
+	TArray<uint8> Indices;
+	for (int32 X = 0; X < 16; X++)
+	{
+		Indices.Add(X < 8 ? 1 : 0);
+	}
+	FPlanetBiomeTextureData Data = MakeBiomeTestTexture(16, 1, Indices);
+	Data.ComputeEdgeDistance(8);
+
+	const TArray<uint8> Expected = { 0, 1, 2, 3, 3, 2, 1, 0, 0, 1, 2, 3, 3, 2, 1, 0 };
+	TestEqual(TEXT("Distances wrap across the seam"), Data.GetEdgeDistances(), Expected);
+	TestEqual(TEXT("Seam texels are on the border"), Data.SampleEdgeDistance(TexelCentre(0, 16), 0.5f), 0.f);
+	TestEqual(TEXT("Distances are normalized by MaxDistance"), Data.SampleEdgeDistance(TexelCentre(3, 16), 0.5f), 3.f / 8.f);
+
+	Data.ComputeEdgeDistance(2);
+	TestEqual(TEXT("Distances are clamped to MaxDistance"), int32(Data.GetEdgeDistances()[3]), 2);
+
+	return true;
+}
+
+#endif
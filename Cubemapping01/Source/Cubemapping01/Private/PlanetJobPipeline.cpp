@@ -0,0 +1,341 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+
+#include "PlanetJobPipeline.h"
+#include "Async/Async.h"
+
+FPlanetJobPipeline::FPlanetJobPipeline(FExecutor InBackgroundExecutor, int32 InMaxBackgroundTasks)
+	: BackgroundExecutor(MoveTemp(InBackgroundExecutor))
+	, MaxBackgroundTasks(FMath::Max(InMaxBackgroundTasks, 1))
+	, Completions(MakeShared<FCompletionQueue, ESPMode::ThreadSafe>())
+{
+	if (!BackgroundExecutor)
+	{
+		BackgroundExecutor = [](TFunction<void()> Function)
+		{
+			AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, MoveTemp(Function));
+		};
+	}
+}
+
+FPlanetJobPipeline::~FPlanetJobPipeline()
+{
+	// In flight background tasks only keep the completion queue alive, their results are dropped
+	CancelAll();
+}
+
+int32 FPlanetJobPipeline::CreateJob(float Priority, FOnJobCompleted OnCompleted)
+{
+	check(IsInGameThread());
+	const int32 JobId = NextJobId++;
+	FJob& Job = Jobs.Add(JobId);
+	Job.Priority = Priority;
+	Job.bCancelled = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+	Job.OnCompleted = MoveTemp(OnCompleted);
+	return JobId;
+}
+
+int32 FPlanetJobPipeline::AddTask(int32 JobId, FName Name, EPlanetJobThread Thread, FTaskFunction Work, const TArray<int32>& Dependencies)
+{
+	check(IsInGameThread());
+	FJob* Job = Jobs.Find(JobId);
+	if (!ensure(Job) || !ensure(Work))
+	{
+		return INDEX_NONE;
+	}
+	// The outcome of a forgotten task is unknown, it may have failed
+	for (const int32 Dependency : Dependencies)
+	{
+		if (!Tasks.Contains(Dependency))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Planet job %d: task %s depends on unknown task %d"), JobId, *Name.ToString(), Dependency);
+			return INDEX_NONE;
+		}
+	}
+
+	const int32 TaskId = NextTaskId++;
+	FTask& Task = Tasks.Add(TaskId);
+	Task.JobId = JobId;
+	Task.Name = Name;
+	Task.Thread = Thread;
+	Task.Work = MoveTemp(Work);
+	Task.Dependencies = Dependencies;
+	Job->Tasks.Add(TaskId);
+
+	bool bDependencyFailed = *Job->bCancelled;
+	for (const int32 Dependency : Dependencies)
+	{
+		const FTask* DependencyTask = Tasks.Find(Dependency);
+		if (DependencyTask && (DependencyTask->State == ETaskState::Failed || DependencyTask->State == ETaskState::Cancelled))
+		{
+			bDependencyFailed = true;
+		}
+	}
+	if (bDependencyFailed)
+	{
+		Task.State = ETaskState::Cancelled;
+		Task.Work = nullptr;
+	}
+	return TaskId;
+}
+
+void FPlanetJobPipeline::SetPriority(int32 JobId, float Priority)
+{
+	check(IsInGameThread());
+	if (FJob* Job = Jobs.Find(JobId))
+	{
+		Job->Priority = Priority;
+	}
+}
+
+void FPlanetJobPipeline::CancelJob(int32 JobId)
+{
+	check(IsInGameThread());
+	FJob* Job = Jobs.Find(JobId);
+	if (!Job)
+	{
+		return;
+	}
+
+	*Job->bCancelled = true;
+	for (const int32 TaskId : Job->Tasks)
+	{
+		FTask& Task = Tasks[TaskId];
+		if (Task.State == ETaskState::Pending)
+		{
+			Task.State = ETaskState::Cancelled;
+			Task.Work = nullptr;
+			CancelDependents(TaskId);
+		}
+	}
+}
+
+void FPlanetJobPipeline::CancelAll()
+{
+	TArray<int32> JobIds;
+	Jobs.GenerateKeyArray(JobIds);
+	for (const int32 JobId : JobIds)
+	{
+		CancelJob(JobId);
+	}
+}
+
+void FPlanetJobPipeline::Tick(int32 MaxGameThreadTasks)
+{
+	check(IsInGameThread());
+
+	TPair<int32, bool> Completed;
+	while (Completions->Dequeue(Completed))
+	{
+		NumRunningBackgroundTasks--;
+		FinishTask(Completed.Key, Completed.Value);
+	}
+
+	int32 GameThreadBudget = MaxGameThreadTasks;
+	while (true)
+	{
+		const int32 TaskId = FindNextReadyTask(GameThreadBudget > 0, NumRunningBackgroundTasks < MaxBackgroundTasks);
+		if (TaskId == INDEX_NONE)
+		{
+			break;
+		}
+		if (Tasks[TaskId].Thread == EPlanetJobThread::GameThread)
+		{
+			GameThreadBudget--;
+		}
+		RunTask(TaskId);
+	}
+
+	RemoveFinishedJobs();
+}
+
+bool FPlanetJobPipeline::GetJobState(int32 JobId, EPlanetJobState& OutState) const
+{
+	if (const FJob* Job = Jobs.Find(JobId))
+	{
+		OutState = ComputeJobState(*Job);
+		return true;
+	}
+	return false;
+}
+
+int32 FPlanetJobPipeline::FindNextReadyTask(bool bGameThreadAllowed, bool bBackgroundAllowed)
+{
+	int32 BestTaskId = INDEX_NONE;
+	float BestPriority = 0.f;
+	for (const auto& It : Tasks)
+	{
+		const FTask& Task = It.Value;
+		if (Task.State != ETaskState::Pending)
+		{
+			continue;
+		}
+		if (!(Task.Thread == EPlanetJobThread::GameThread ? bGameThreadAllowed : bBackgroundAllowed))
+		{
+			continue;
+		}
+
+		// Failures are propagated to the dependents right away, so a dependency that is gone succeeded
+		// and was forgotten with its job
+		bool bReady = true;
+		for (const int32 Dependency : Task.Dependencies)
+		{
+			const FTask* DependencyTask = Tasks.Find(Dependency);
+			if (DependencyTask && DependencyTask->State != ETaskState::Succeeded)
+			{
+				bReady = false;
+				break;
+			}
+		}
+		if (!bReady)
+		{
+			continue;
+		}
+
+		// Oldest task first between equal priorities
+		const float Priority = Jobs[Task.JobId].Priority;
+		if (BestTaskId == INDEX_NONE || Priority > BestPriority || (Priority == BestPriority && It.Key < BestTaskId))
+		{
+			BestTaskId = It.Key;
+			BestPriority = Priority;
+		}
+	}
+	return BestTaskId;
+}
+
+void FPlanetJobPipeline::RunTask(int32 TaskId)
+{
+	FTask& Task = Tasks[TaskId];
+	check(Task.State == ETaskState::Pending);
+	Task.State = ETaskState::Running;
+
+	FPlanetTaskContext Context;
+	Context.JobId = Task.JobId;
+	Context.TaskId = TaskId;
+	Context.bCancelled = Jobs[Task.JobId].bCancelled;
+
+	FTaskFunction Work = MoveTemp(Task.Work);
+	Task.Work = nullptr;
+
+	if (Task.Thread == EPlanetJobThread::GameThread)
+	{
+		const bool bSuccess = !Context.IsCancelled() && Work(Context);
+		FinishTask(TaskId, bSuccess);
+		return;
+	}
+
+	NumRunningBackgroundTasks++;
+	BackgroundExecutor([Work = MoveTemp(Work), Context, Completions = Completions, TaskId]()
+	{
+		const bool bSuccess = !Context.IsCancelled() && Work(Context);
+		Completions->Enqueue(MakeTuple(TaskId, bSuccess));
+	});
+}
+
+void FPlanetJobPipeline::FinishTask(int32 TaskId, bool bSuccess)
+{
+	FTask* Task = Tasks.Find(TaskId);
+	if (!Task)
+	{
+		return;
+	}
+
+	FJob& Job = Jobs[Task->JobId];
+	if (bSuccess)
+	{
+		Task->State = ETaskState::Succeeded;
+		return;
+	}
+
+	if (*Job.bCancelled)
+	{
+		Task->State = ETaskState::Cancelled;
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Planet job %d: task %s failed"), Task->JobId, *Task->Name.ToString());
+		Task->State = ETaskState::Failed;
+		// The job can't complete anymore, stop its other stages
+		*Job.bCancelled = true;
+		for (const int32 OtherTaskId : Job.Tasks)
+		{
+			FTask& OtherTask = Tasks[OtherTaskId];
+			if (OtherTask.State == ETaskState::Pending)
+			{
+				OtherTask.State = ETaskState::Cancelled;
+				OtherTask.Work = nullptr;
+			}
+		}
+	}
+
+	CancelDependents(TaskId);
+}
+
+void FPlanetJobPipeline::CancelDependents(int32 TaskId)
+{
+	TArray<int32> Queue = { TaskId };
+	while (Queue.Num() > 0)
+	{
+		const int32 Current = Queue.Pop(false);
+		for (auto& It : Tasks)
+		{
+			FTask& Task = It.Value;
+			if (Task.State == ETaskState::Pending && Task.Dependencies.Contains(Current))
+			{
+				Task.State = ETaskState::Cancelled;
+				Task.Work = nullptr;
+				Queue.Add(It.Key);
+			}
+		}
+	}
+}
+
+EPlanetJobState FPlanetJobPipeline::ComputeJobState(const FJob& Job) const
+{
+	bool bStarted = false;
+	bool bAllSucceeded = true;
+	bool bFailed = false;
+	bool bCancelled = *Job.bCancelled;
+	for (const int32 TaskId : Job.Tasks)
+	{
+		const ETaskState State = Tasks[TaskId].State;
+		bStarted |= State != ETaskState::Pending;
+		bAllSucceeded &= State == ETaskState::Succeeded;
+		bFailed |= State == ETaskState::Failed;
+		// Also set when a dependency in another job failed
+		bCancelled |= State == ETaskState::Cancelled;
+	}
+
+	if (bFailed) return EPlanetJobState::Failed;
+	if (bCancelled) return EPlanetJobState::Cancelled;
+	if (bAllSucceeded) return EPlanetJobState::Succeeded;
+	return bStarted ? EPlanetJobState::Running : EPlanetJobState::Queued;
+}
+
+void FPlanetJobPipeline::RemoveFinishedJobs()
+{
+	TArray<TPair<int32, FJob>> Finished;
+	for (auto It = Jobs.CreateIterator(); It; ++It)
+	{
+		const bool bDone = !It.Value().Tasks.ContainsByPredicate([&](int32 TaskId) { return !IsFinished(Tasks[TaskId].State); });
+		if (bDone)
+		{
+			Finished.Emplace(It.Key(), MoveTemp(It.Value()));
+			It.RemoveCurrent();
+		}
+	}
+
+	for (auto& It : Finished)
+	{
+		// Computed before the tasks are gone
+		const EPlanetJobState State = ComputeJobState(It.Value);
+		for (const int32 TaskId : It.Value.Tasks)
+		{
+			Tasks.Remove(TaskId);
+		}
+		if (It.Value.OnCompleted)
+		{
+			It.Value.OnCompleted(It.Key, State);
+		}
+	}
+}
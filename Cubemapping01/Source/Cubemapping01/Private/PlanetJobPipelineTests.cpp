@@ -0,0 +1,157 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+
+#include "PlanetJobPipeline.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Background tasks are queued and run on demand, to control what is in flight
+struct FPlanetJobTestExecutor
+{
+	TSharedRef<TArray<TFunction<void()>>> Queued = MakeShared<TArray<TFunction<void()>>>();
+
+	FPlanetJobPipeline::FExecutor Get() const
+	{
+		const auto LocalQueued = Queued;
+		return [LocalQueued](TFunction<void()> Function) { LocalQueued->Add(MoveTemp(Function)); };
+	}
+	void RunAll() const
+	{
+		TArray<TFunction<void()>> Functions = MoveTemp(*Queued);
+		Queued->Reset();
+		for (auto& Function : Functions)
+		{
+			Function();
+		}
+	}
+};
+
+static const FPlanetJobPipeline::FExecutor SynchronousExecutor = [](TFunction<void()> Function) { Function(); };
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlanetJobPipelinePriorityTest, "Cubemapping01.PlanetJobPipeline.Priority", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPlanetJobPipelinePriorityTest::RunTest(const FString& Parameters)
+{
+	FPlanetJobPipeline Pipeline(SynchronousExecutor);
+	TArray<int32> Order;
+
+	const auto AddPlanet = [&](float Priority)
+	{
+		const int32 JobId = Pipeline.CreateJob(Priority);
+		Pipeline.AddTask(JobId, "Stage", EPlanetJobThread::GameThread, [&Order, JobId](const FPlanetTaskContext&)
+		{
+			Order.Add(JobId);
+			return true;
+		});
+		return JobId;
+	};
+
+	const int32 Far = AddPlanet(-300.f);
+	const int32 Near = AddPlanet(-10.f);
+	const int32 Middle = AddPlanet(-100.f);
+
+	Pipeline.Tick(1);
+	TestEqual(TEXT("Highest priority runs first"), Order, TArray<int32>({ Near }));
+
+	// The player turned towards the far planet
+	Pipeline.SetPriority(Far, 0.f);
+	Pipeline.Tick(1);
+	Pipeline.Tick(1);
+	TestEqual(TEXT("Priority changes apply to pending jobs"), Order, TArray<int32>({ Near, Far, Middle }));
+	TestTrue(TEXT("Finished jobs are forgotten"), Pipeline.IsIdle());
+
+	// Dependencies hold regardless of priority
+	Order.Reset();
+	const int32 Low = Pipeline.CreateJob(0.f);
+	const int32 High = Pipeline.CreateJob(1.f);
+	const int32 First = Pipeline.AddTask(Low, "First", EPlanetJobThread::GameThread, [&Order, Low](const FPlanetTaskContext&) { Order.Add(Low); return true; });
+	Pipeline.AddTask(High, "Second", EPlanetJobThread::GameThread, [&Order, High](const FPlanetTaskContext&) { Order.Add(High); return true; }, { First });
+	Pipeline.Tick(2);
+	TestEqual(TEXT("Dependencies run before dependents"), Order, TArray<int32>({ Low, High }));
+
+	// The outcome of a completed job is forgotten, tasks can't depend on it anymore
+	AddExpectedError(TEXT("unknown task"), EAutomationExpectedErrorFlags::Contains, 2);
+	const int32 Late = Pipeline.CreateJob(0.f);
+	TestEqual(TEXT("Dependencies on forgotten tasks are rejected"), Pipeline.AddTask(Late, "Late", EPlanetJobThread::GameThread, [](const FPlanetTaskContext&) { return true; }, { First }), int32(INDEX_NONE));
+	TestEqual(TEXT("Dependencies on unknown tasks are rejected"), Pipeline.AddTask(Late, "Late", EPlanetJobThread::GameThread, [](const FPlanetTaskContext&) { return true; }, { 12345 }), int32(INDEX_NONE));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlanetJobPipelineCancelTest, "Cubemapping01.PlanetJobPipeline.Cancel", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPlanetJobPipelineCancelTest::RunTest(const FString& Parameters)
+{
+	FPlanetJobTestExecutor Executor;
+	FPlanetJobPipeline Pipeline(Executor.Get());
+
+	bool bConverted = false;
+	bool bRegistered = false;
+	EPlanetJobState CompletedState = EPlanetJobState::Queued;
+
+	const int32 JobId = Pipeline.CreateJob(0.f, [&](int32, EPlanetJobState State) { CompletedState = State; });
+	const int32 Readback = Pipeline.AddTask(JobId, "Readback", EPlanetJobThread::GameThread, [](const FPlanetTaskContext&) { return true; });
+	const int32 Convert = Pipeline.AddTask(JobId, "Convert", EPlanetJobThread::AnyThread, [&](const FPlanetTaskContext&) { bConverted = true; return true; }, { Readback });
+	Pipeline.AddTask(JobId, "Register", EPlanetJobThread::GameThread, [&](const FPlanetTaskContext&) { bRegistered = true; return true; }, { Convert });
+
+	// Readback runs, Convert is dispatched but not executed yet
+	Pipeline.Tick(1);
+	TestEqual(TEXT("Convert is in flight"), Executor.Queued->Num(), 1);
+
+	EPlanetJobState State;
+	TestTrue(TEXT("Job is known"), Pipeline.GetJobState(JobId, State));
+	TestEqual(TEXT("Job is running"), State, EPlanetJobState::Running);
+
+	Pipeline.CancelJob(JobId);
+	Executor.RunAll();
+	Pipeline.Tick(1);
+
+	TestFalse(TEXT("In flight work of a cancelled job bails out"), bConverted);
+	TestFalse(TEXT("Pending stages of a cancelled job don't run"), bRegistered);
+	TestEqual(TEXT("Job completes as cancelled"), CompletedState, EPlanetJobState::Cancelled);
+	TestTrue(TEXT("Cancelled job is forgotten"), Pipeline.IsIdle());
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlanetJobPipelineFailureTest, "Cubemapping01.PlanetJobPipeline.Failure", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPlanetJobPipelineFailureTest::RunTest(const FString& Parameters)
+{
+	FPlanetJobPipeline Pipeline(SynchronousExecutor);
+
+	TMap<int32, EPlanetJobState> Completed;
+	const auto OnCompleted = [&Completed](int32 JobId, EPlanetJobState State) { Completed.Add(JobId, State); };
+
+	bool bDependentRan = false;
+	bool bOtherJobRan = false;
+	bool bUnrelatedRan = false;
+
+	AddExpectedError(TEXT("failed"), EAutomationExpectedErrorFlags::Contains, 1);
+
+	const int32 Failing = Pipeline.CreateJob(1.f, OnCompleted);
+	const int32 Render = Pipeline.AddTask(Failing, "Render", EPlanetJobThread::GameThread, [](const FPlanetTaskContext&) { return false; });
+	Pipeline.AddTask(Failing, "Readback", EPlanetJobThread::AnyThread, [&](const FPlanetTaskContext&) { bDependentRan = true; return true; }, { Render });
+
+	const int32 Dependent = Pipeline.CreateJob(0.f, OnCompleted);
+	Pipeline.AddTask(Dependent, "UsesRender", EPlanetJobThread::GameThread, [&](const FPlanetTaskContext&) { bOtherJobRan = true; return true; }, { Render });
+
+	const int32 Unrelated = Pipeline.CreateJob(0.f, OnCompleted);
+	Pipeline.AddTask(Unrelated, "Stage", EPlanetJobThread::GameThread, [&](const FPlanetTaskContext&) { bUnrelatedRan = true; return true; });
+
+	Pipeline.Tick(4);
+	Pipeline.Tick(4);
+
+	TestFalse(TEXT("Stages after a failed one don't run"), bDependentRan);
+	TestFalse(TEXT("Tasks of other jobs depending on a failed task don't run"), bOtherJobRan);
+	TestTrue(TEXT("Unrelated jobs still run"), bUnrelatedRan);
+	TestEqual(TEXT("Failing job completes as failed"), Completed.FindRef(Failing), EPlanetJobState::Failed);
+	TestEqual(TEXT("Dependent job completes as cancelled"), Completed.FindRef(Dependent), EPlanetJobState::Cancelled);
+	TestEqual(TEXT("Unrelated job succeeds"), Completed.FindRef(Unrelated), EPlanetJobState::Succeeded);
+	TestTrue(TEXT("All jobs are forgotten"), Pipeline.IsIdle());
+
+	return true;
+}
+
+#endif
@@ -2,16 +2,45 @@
 
 
 #include "PlanetManagerSubsystem.h"
+#include "PlanetTextureCache.h"
 #include "Engine/TextureRenderTarget2D.h"
+#include "Engine/TextureRenderTargetCube.h"
 #include "Kismet/KismetRenderingLibrary.h"
 
 void UPlanetManagerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
+	Pipeline = MakeUnique<FPlanetJobPipeline>();
+}
 
+void UPlanetManagerSubsystem::SetPipelineExecutor(FPlanetJobPipeline::FExecutor Executor)
+{
+	check(Pipeline->IsIdle());
+	Pipeline = MakeUnique<FPlanetJobPipeline>(MoveTemp(Executor));
 }
 
 void UPlanetManagerSubsystem::Deinitialize()
 {
+	// Let the pending jobs complete as cancelled, so they release their resources and OnPlanetJobCompleted fires.
+	// Background tasks already running have to report back first.
+	Pipeline->CancelAll();
+	const double StartTime = FPlatformTime::Seconds();
+	while (true)
+	{
+		Pipeline->Tick(0);
+		if (Pipeline->IsIdle())
+		{
+			break;
+		}
+		if (FPlatformTime::Seconds() - StartTime > 5.0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Planet jobs: %d jobs didn't finish before shutdown, their resources are not released"), Pipeline->GetNumJobs());
+			break;
+		}
+		FPlatformProcess::Sleep(0.001f);
+	}
+	Pipeline.Reset();
+	ActiveJobs.Empty();
+
 	TArray<FRenderTargetSlot> Values;
 	RenderTargetStorage.GenerateValueArray(Values);
 	for (FRenderTargetSlot Slot : Values)
@@ -44,3 +73,187 @@ void UPlanetManagerSubsystem::SetupTexturesIfNot(FRenderTargetConfig Config)
 		bInitialized = true;
 	}
 }
+
+void UPlanetManagerSubsystem::Tick(float DeltaTime)
+{
+	Pipeline->Tick(MaxGameThreadTasksPerFrame);
+}
+
+bool UPlanetManagerSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Pipeline.IsValid() && !Pipeline->IsIdle();
+}
+
+TStatId UPlanetManagerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPlanetManagerSubsystem, STATGROUP_Tickables);
+}
+
+int32 UPlanetManagerSubsystem::RequestPlanet(FPlanetGenerationRequest Request, float Priority, FPlanetRenderDelegate Render)
+{
+	return RequestPlanetWithStages(Request, Priority, [Render](const FPlanetResource& Resource)
+	{
+		return Render.IsBound() && Render.Execute(Resource);
+	});
+}
+
+int32 UPlanetManagerSubsystem::RequestPlanetWithStages(const FPlanetGenerationRequest& Request, float Priority, FRenderStage Render, FReadbackStage Readback)
+{
+	check(Pipeline.IsValid());
+	if (!Readback)
+	{
+		Readback = &UFiveFunctionLibrary::ReadRenderTargetPixels;
+	}
+
+	// Shared between the stages of the job
+	struct FPlanetJobData
+	{
+		FPlanetResource Resource;
+		// Set once Create ran, so a cancelled or failed job only releases what it created.
+		// The cubemap is only set if this job created it, an existing one is reused by CreatePlanetResource.
+		TWeakObjectPtr<UTextureRenderTarget2D> RenderTarget;
+		TWeakObjectPtr<UTextureRenderTargetCube> CreatedCubemap;
+		int32 SizeX = 0;
+		int32 SizeY = 0;
+		TArray<FColor> Pixels;
+		TVoxelSharedPtr<TVoxelTexture<FColor>::FTextureData> Colours;
+		TVoxelSharedPtr<TVoxelTexture<float>::FTextureData> Floats;
+		// Content hashes, computed in the background stages so the game thread only looks them up
+		uint64 ColoursHash = 0;
+		uint64 FloatsHash = 0;
+		bool bConverted = false;
+	};
+	const TSharedRef<FPlanetJobData, ESPMode::ThreadSafe> Data = MakeShared<FPlanetJobData, ESPMode::ThreadSafe>();
+
+	// The resource is about to be recreated, the older job would only overwrite it
+	for (const auto& It : ActiveJobs)
+	{
+		if (It.Value.TextureKey == Request.TextureKey)
+		{
+			Pipeline->CancelJob(It.Key);
+		}
+	}
+
+	TWeakObjectPtr<UPlanetManagerSubsystem> WeakThis = this;
+	const int32 JobId = Pipeline->CreateJob(Priority, [WeakThis, Data](int32 CompletedJobId, EPlanetJobState State)
+	{
+		UPlanetManagerSubsystem* This = WeakThis.Get();
+		if (This)
+		{
+			This->ActiveJobs.Remove(CompletedJobId);
+		}
+
+		if (State != EPlanetJobState::Succeeded && Data->RenderTarget.IsValid())
+		{
+			// Unless a newer job recreated the resource in the meantime
+			bool bSuccess = false;
+			if (UFiveFunctionLibrary::GetRenderTarget2DFromResource(Data->Resource, bSuccess) == Data->RenderTarget.Get())
+			{
+				// Other pending planets may have picked up the cubemap this job created
+				const bool bDiscardCubemap = Data->CreatedCubemap.IsValid() &&
+					UFiveFunctionLibrary::GetRenderTargetCubeFromResource(Data->Resource, bSuccess) == Data->CreatedCubemap.Get() &&
+					!(This && This->IsCubemapInUse(Data->Resource.CubemapKey));
+				UFiveFunctionLibrary::DiscardPlanetResource(Data->Resource, bDiscardCubemap);
+			}
+		}
+		if (This)
+		{
+			This->OnPlanetJobCompleted.Broadcast(CompletedJobId, State);
+		}
+	});
+	ActiveJobs.Add(JobId, Request);
+
+	const int32 Create = Pipeline->AddTask(JobId, "Create", EPlanetJobThread::GameThread, [WeakThis, Request, Data](const FPlanetTaskContext&)
+	{
+		if (!WeakThis.IsValid()) return false;
+		FPlanetResource Keys;
+		Keys.CubemapKey = Request.CubemapKey;
+		bool bSuccess = false;
+		UTextureRenderTargetCube* ExistingCubemap = UFiveFunctionLibrary::GetRenderTargetCubeFromResource(Keys, bSuccess);
+
+		Data->Resource = UFiveFunctionLibrary::CreatePlanetResource(WeakThis->GetWorld(), Request.CubemapKey, Request.TextureKey, Request.Width);
+		Data->RenderTarget = UFiveFunctionLibrary::GetRenderTarget2DFromResource(Data->Resource, bSuccess);
+		UTextureRenderTargetCube* Cubemap = UFiveFunctionLibrary::GetRenderTargetCubeFromResource(Data->Resource, bSuccess);
+		if (Cubemap != ExistingCubemap)
+		{
+			Data->CreatedCubemap = Cubemap;
+		}
+		return UFiveFunctionLibrary::IsPlanetResourceValid(Data->Resource);
+	});
+
+	const int32 RenderTask = Pipeline->AddTask(JobId, "Render", EPlanetJobThread::GameThread, [Render, Data](const FPlanetTaskContext&)
+	{
+		return Render(Data->Resource);
+	}, { Create });
+
+	const int32 ReadbackTask = Pipeline->AddTask(JobId, "Readback", EPlanetJobThread::GameThread, [Readback, Data](const FPlanetTaskContext&)
+	{
+		return Readback(Data->Resource, Data->SizeX, Data->SizeY, Data->Pixels);
+	}, { RenderTask });
+
+	const int32 Build = Pipeline->AddTask(JobId, "Build", EPlanetJobThread::AnyThread, [Data](const FPlanetTaskContext&)
+	{
+		Data->Colours = UFiveFunctionLibrary::MakeColourTextureData(Data->SizeX, Data->SizeY, Data->Pixels);
+		Data->ColoursHash = HashPlanetTextureData(*Data->Colours);
+		Data->Pixels.Empty();
+		return true;
+	}, { ReadbackTask });
+
+	const int32 Deduplicate = Pipeline->AddTask(JobId, "Deduplicate", EPlanetJobThread::GameThread, [Channel = Request.Channel, Data](const FPlanetTaskContext&)
+	{
+		Data->Colours = UFiveFunctionLibrary::PoolColourTextureData(Data->Colours.ToSharedRef(), Data->ColoursHash);
+		Data->Floats = UFiveFunctionLibrary::FindChannelConversion(Data->Colours.ToSharedRef(), Channel);
+		return true;
+	}, { Build });
+
+	// Skipped when an identical planet was already converted
+	const int32 Convert = Pipeline->AddTask(JobId, "Convert", EPlanetJobThread::AnyThread, [Channel = Request.Channel, Data](const FPlanetTaskContext&)
+	{
+		if (!Data->Floats.IsValid())
+		{
+			Data->Floats = UFiveFunctionLibrary::ConvertColourChannelToFloat(*Data->Colours, Channel);
+			Data->FloatsHash = HashPlanetTextureData(*Data->Floats);
+			Data->bConverted = true;
+		}
+		return true;
+	}, { Deduplicate });
+
+	Pipeline->AddTask(JobId, "Register", EPlanetJobThread::GameThread, [WeakThis, Channel = Request.Channel, Data](const FPlanetTaskContext&)
+	{
+		if (Data->bConverted && WeakThis.IsValid())
+		{
+			WeakThis->NumChannelConversions++;
+		}
+		UFiveFunctionLibrary::RegisterVoxelTextureData(Data->Resource, Channel, Data->Colours.ToSharedRef(), Data->Floats.ToSharedRef(), Data->FloatsHash);
+		return true;
+	}, { Convert });
+
+	return JobId;
+}
+
+void UPlanetManagerSubsystem::SetPlanetPriority(int32 JobId, float Priority)
+{
+	Pipeline->SetPriority(JobId, Priority);
+}
+
+void UPlanetManagerSubsystem::CancelPlanet(int32 JobId)
+{
+	Pipeline->CancelJob(JobId);
+}
+
+bool UPlanetManagerSubsystem::IsCubemapInUse(const FString& CubemapKey) const
+{
+	for (const auto& It : ActiveJobs)
+	{
+		if (It.Value.CubemapKey == CubemapKey)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool UPlanetManagerSubsystem::GetPlanetJobState(int32 JobId, EPlanetJobState& State) const
+{
+	return Pipeline->GetJobState(JobId, State);
+}
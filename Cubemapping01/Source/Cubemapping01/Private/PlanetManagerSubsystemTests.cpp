@@ -0,0 +1,106 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+
+#include "PlanetManagerSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlanetManagerSubsystemJobsTest, "Cubemapping01.PlanetManagerSubsystem.Jobs", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPlanetManagerSubsystemJobsTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	UPlanetManagerSubsystem* Subsystem = World->GetSubsystem<UPlanetManagerSubsystem>();
+	if (!TestNotNull(TEXT("Subsystem is created with the world"), Subsystem))
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+		return false;
+	}
+
+	// Everything runs from the ticks below, background stages included
+	Subsystem->SetPipelineExecutor([](TFunction<void()> Function) { Function(); });
+	Subsystem->MaxGameThreadTasksPerFrame = 16;
+
+	// Stand-ins for the GPU, every planet reads back the same pixels
+	const auto Render = [](const FPlanetResource&) { return true; };
+	const auto Readback = [](const FPlanetResource&, int32& OutSizeX, int32& OutSizeY, TArray<FColor>& OutPixels)
+	{
+		OutSizeX = 8;
+		OutSizeY = 4;
+		OutPixels.SetNumUninitialized(OutSizeX * OutSizeY);
+		for (int32 Index = 0; Index < OutPixels.Num(); Index++)
+		{
+			OutPixels[Index] = FColor(uint8(Index * 7), uint8(Index), 0, 255);
+		}
+		return true;
+	};
+
+	const auto MakeRequest = [](const FString& Name)
+	{
+		FPlanetGenerationRequest Request;
+		Request.TextureKey = TEXT("PlanetManagerSubsystemTest_") + Name;
+		Request.CubemapKey = TEXT("PlanetManagerSubsystemTest_Cube") + Name;
+		Request.Width = 16;
+		return Request;
+	};
+	const auto TickUntilCompleted = [&](int32 JobId)
+	{
+		EPlanetJobState State;
+		for (int32 Index = 0; Index < 32 && Subsystem->GetPlanetJobState(JobId, State); Index++)
+		{
+			Subsystem->Tick(0.f);
+		}
+	};
+	const auto HasRenderTarget = [](const FString& Key)
+	{
+		bool bSuccess = false;
+		UFiveFunctionLibrary::GetCachedRT(Key, bSuccess);
+		return bSuccess;
+	};
+
+	const FPlanetGenerationRequest A = MakeRequest(TEXT("A"));
+	TickUntilCompleted(Subsystem->RequestPlanetWithStages(A, 0.f, Render, Readback));
+	const auto FloatsA = UFiveFunctionLibrary::GetCachedFloatTextureData(A.TextureKey);
+	TestTrue(TEXT("First planet is registered"), FloatsA.IsValid());
+
+	// Identical content under other keys
+	const int32 NumConversions = Subsystem->GetNumChannelConversions();
+	const FPlanetGenerationRequest B = MakeRequest(TEXT("B"));
+	TickUntilCompleted(Subsystem->RequestPlanetWithStages(B, 0.f, Render, Readback));
+	const auto FloatsB = UFiveFunctionLibrary::GetCachedFloatTextureData(B.TextureKey);
+	TestTrue(TEXT("Second planet is registered"), FloatsB.IsValid());
+	TestTrue(TEXT("Identical planets share one float texture"), FloatsA.IsValid() && FloatsA == FloatsB);
+	TestEqual(TEXT("Identical planet skips the conversion"), Subsystem->GetNumChannelConversions(), NumConversions);
+
+	// Cancelled once its resource exists
+	const FPlanetGenerationRequest C = MakeRequest(TEXT("C"));
+	const int32 JobC = Subsystem->RequestPlanetWithStages(C, 0.f, Render, Readback);
+	Subsystem->Tick(0.f);
+	TestTrue(TEXT("Cancelled planet was created"), HasRenderTarget(C.TextureKey) && HasRenderTarget(C.CubemapKey));
+	Subsystem->CancelPlanet(JobC);
+	TickUntilCompleted(JobC);
+	TestFalse(TEXT("Cancelled planet releases its render target"), HasRenderTarget(C.TextureKey));
+	TestFalse(TEXT("Cancelled planet releases the cubemap it created"), HasRenderTarget(C.CubemapKey));
+	TestFalse(TEXT("Cancelled planet isn't registered"), UFiveFunctionLibrary::GetCachedFloatTextureData(C.TextureKey).IsValid());
+
+	for (const FPlanetGenerationRequest& Request : { A, B })
+	{
+		FPlanetResource Resource;
+		Resource.TextureKey = Request.TextureKey;
+		Resource.CubemapKey = Request.CubemapKey;
+		UFiveFunctionLibrary::DiscardPlanetResource(Resource, true);
+	}
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+
+#include "PlanetTextureCache.h"
+#include "Hash/CityHash.h"
+
+template<typename T>
+inline uint64 HashTexels(const TArray<T>& Texels, int32 SizeX, int32 SizeY)
+{
+	const uint64 Seed = (uint64(uint32(SizeX)) << 32) | uint32(SizeY);
+	return CityHash64WithSeed(reinterpret_cast<const char*>(Texels.GetData()), Texels.Num() * sizeof(T), Seed);
+}
+
+template<typename T>
+inline bool AreTexelsEqual(const TArray<T>& A, const TArray<T>& B)
+{
+	return A.Num() == B.Num() && FMemory::Memcmp(A.GetData(), B.GetData(), A.Num() * sizeof(T)) == 0;
+}
+
+uint64 HashPlanetTextureData(const TVoxelTexture<FColor>::FTextureData& Data)
+{
+	return HashTexels(Data.GetTextureData(), Data.GetSizeX(), Data.GetSizeY());
+}
+
+uint64 HashPlanetTextureData(const TVoxelTexture<float>::FTextureData& Data)
+{
+	return HashTexels(Data.GetTextureData(), Data.GetSizeX(), Data.GetSizeY());
+}
+
+uint64 HashPlanetTextureData(const FPlanetBiomeTextureData& Data)
+{
+	uint64 Hash = HashTexels(Data.GetIndices(), Data.GetSizeX(), Data.GetSizeY());
+	Hash = CityHash128to64(Uint128_64(Hash, HashTexels(Data.GetEdgeDistances(), Data.GetMaxEdgeDistance(), 0)));
+	// The palette is tiny and compared in full on a hash match
+	return CityHash128to64(Uint128_64(Hash, Data.GetPalette().Num()));
+}
+
+bool ArePlanetTextureDataEqual(const TVoxelTexture<FColor>::FTextureData& A, const TVoxelTexture<FColor>::FTextureData& B)
+{
+	return A.GetSizeX() == B.GetSizeX() && A.GetSizeY() == B.GetSizeY() && AreTexelsEqual(A.GetTextureData(), B.GetTextureData());
+}
+
+bool ArePlanetTextureDataEqual(const TVoxelTexture<float>::FTextureData& A, const TVoxelTexture<float>::FTextureData& B)
+{
+	return A.GetSizeX() == B.GetSizeX() && A.GetSizeY() == B.GetSizeY() && AreTexelsEqual(A.GetTextureData(), B.GetTextureData());
+}
+
+bool ArePlanetTextureDataEqual(const FPlanetBiomeTextureData& A, const FPlanetBiomeTextureData& B)
+{
+	return A.GetSizeX() == B.GetSizeX() && A.GetSizeY() == B.GetSizeY() &&
+		A.GetMaxEdgeDistance() == B.GetMaxEdgeDistance() &&
+		AreTexelsEqual(A.GetIndices(), B.GetIndices()) &&
+		AreTexelsEqual(A.GetEdgeDistances(), B.GetEdgeDistances()) &&
+		A.GetPalette() == B.GetPalette();
+}
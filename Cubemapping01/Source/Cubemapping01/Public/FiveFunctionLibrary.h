@@ -6,6 +6,7 @@
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "VoxelTexture.h"
+#include "PlanetBiomeTexture.h"
 //#include "VoxelNodes/VoxelNodeHelpers.h"
 #include "FiveFunctionLibrary.generated.h"
 
@@ -49,6 +50,23 @@ class CUBEMAPPING01_API UFiveFunctionLibrary : public UBlueprintFunctionLibrary
 public:
 	UFUNCTION(BlueprintCallable, meta = (WorldContext = "WorldContext"), Category = "FiveFunctionLibrary | Texture Utilities")
 		static FVoxelFloatTexture CreateVoxelFloatTextureFromRenderTargetChannel(UObject* WorldContext, FPlanetResource Resource, EVoxelRGBA Channel, int MipLevel);
+	// Texture data is shared between identical planets, editing copies it first so the other planets are unaffected.
+	UFUNCTION(BlueprintCallable, Category = "FiveFunctionLibrary | Texture Utilities")
+		static FVoxelFloatTexture SetVoxelFloatTextureValue(FPlanetResource Resource, int32 X, int32 Y, float Value, bool& bSuccess);
+	// Copies the data at most once for the whole batch. Fails without editing if the arrays differ in size or a texel is out of bounds.
+	UFUNCTION(BlueprintCallable, Category = "FiveFunctionLibrary | Texture Utilities")
+		static FVoxelFloatTexture SetVoxelFloatTextureValues(FPlanetResource Resource, const TArray<FIntPoint>& Texels, const TArray<float>& Values, bool& bSuccess);
+
+	/* Biomes, the channel holds the palette index directly (0-255) */
+	UFUNCTION(BlueprintCallable, meta = (WorldContext = "WorldContext"), Category = "FiveFunctionLibrary | Biomes")
+		static FPlanetBiomeTexture CreateBiomeTextureFromRenderTargetChannel(UObject* WorldContext, FPlanetResource Resource, EVoxelRGBA Channel, const TArray<FPlanetBiome>& Palette, bool bComputeEdgeDistance, int32 MaxEdgeDistance = 8);
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "FiveFunctionLibrary | Biomes")
+		static int32 SampleBiomeNearest(const FPlanetBiomeTexture& Texture, float U, float V, FPlanetBiome& Biome, bool& bSuccess);
+	// Most common biome in a (2 * Radius + 1)^2 texel window, Radius is clamped to 8. Ties keep the centre texel.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "FiveFunctionLibrary | Biomes")
+		static int32 SampleBiomeMajority(const FPlanetBiomeTexture& Texture, float U, float V, int32 Radius, FPlanetBiome& Biome, bool& bSuccess);
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "FiveFunctionLibrary | Biomes")
+		static float SampleBiomeEdgeDistance(const FPlanetBiomeTexture& Texture, float U, float V);
 
 	UFUNCTION(BlueprintCallable, meta = (WorldContext = "WorldContext"), Category = "FiveFunctionLibrary | Texture Utilities")
 		static UTextureRenderTargetCube* CreateRenderTargetCube(UObject* WorldContext, int32 Width, TextureMipGenSettings MipSettings, FLinearColor ClearColor, TextureCompressionSettings CompressionSettings, bool bHDR, FString TextureKey);
@@ -81,6 +99,24 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure, meta = (WorldContext = "WorldContext"))
 		static UWorld* GetWorld(UObject* WorldContext);
 
+	/* Planet generation stages, used by the job pipeline in UPlanetManagerSubsystem */
+	static bool ReadRenderTargetPixels(FPlanetResource Resource, int32& OutSizeX, int32& OutSizeY, TArray<FColor>& OutData);
+	// Thread safe, don't touch the caches
+	static TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData> MakeColourTextureData(int32 SizeX, int32 SizeY, const TArray<FColor>& Pixels);
+	static TVoxelSharedRef<TVoxelTexture<float>::FTextureData> ConvertColourChannelToFloat(const TVoxelTexture<FColor>::FTextureData& Colours, EVoxelRGBA Channel);
+	// Game thread. Deduplicates colour data before conversion, so an already converted identical planet can skip it.
+	// Hash is HashPlanetTextureData(*Colours), computed with the data off the game thread.
+	static TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData> PoolColourTextureData(const TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData>& Colours, uint64 Hash);
+	static TVoxelSharedPtr<TVoxelTexture<float>::FTextureData> FindChannelConversion(const TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData>& Colours, EVoxelRGBA Channel);
+	// Inserts converted data into the caches (deduplicated), replacing any previous data of the resource.
+	// Colours come from PoolColourTextureData, FloatsHash is HashPlanetTextureData(*Floats) and unused if Floats is already pooled.
+	static FVoxelFloatTexture RegisterVoxelTextureData(FPlanetResource Resource, EVoxelRGBA Channel, const TVoxelSharedRef<TVoxelTexture<FColor>::FTextureData>& Colours, const TVoxelSharedRef<TVoxelTexture<float>::FTextureData>& Floats, uint64 FloatsHash);
+	// Null if nothing was registered for TextureKey. Planets with identical content return the same data.
+	static TVoxelSharedPtr<TVoxelTexture<float>::FTextureData> GetCachedFloatTextureData(const FString& TextureKey);
+	// Releases the render targets and cached textures of this resource only, used when a job is cancelled or fails.
+	// The cubemap may be shared by other resources, it is only released with bDiscardCubemap.
+	static void DiscardPlanetResource(FPlanetResource Resource, bool bDiscardCubemap);
+
 };
 
 
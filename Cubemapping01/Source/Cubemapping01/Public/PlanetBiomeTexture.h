@@ -0,0 +1,97 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelSharedPtr.h"
+#include "PlanetBiomeTexture.generated.h"
+
+/**
+ * Biome textures store one 8-bit palette index per texel instead of expanding the
+ * channel into floats, IDs are categorical so they are only ever sampled nearest or by majority.
+ */
+
+USTRUCT(BlueprintType)
+struct FPlanetBiome
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		FName Name;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		FLinearColor Colour = FLinearColor::White;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		float HeightScale = 1.f;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		float HeightOffset = 0.f;
+
+	bool operator==(const FPlanetBiome& Other) const
+	{
+		return Name == Other.Name && Colour == Other.Colour && HeightScale == Other.HeightScale && HeightOffset == Other.HeightOffset;
+	}
+};
+
+class CUBEMAPPING01_API FPlanetBiomeTextureData
+{
+public:
+	void SetSize(int32 NewSizeX, int32 NewSizeY);
+	void SetIndex(int32 Index, uint8 Value) { Indices[Index] = Value; }
+	void SetPalette(const TArray<FPlanetBiome>& NewPalette) { Palette = NewPalette; }
+
+	// Distance (in texels) from every texel to the nearest texel of a different biome, clamped to MaxDistance.
+	void ComputeEdgeDistance(int32 MaxDistance);
+
+	int32 GetSizeX() const { return SizeX; }
+	int32 GetSizeY() const { return SizeY; }
+	const TArray<uint8>& GetIndices() const { return Indices; }
+	const TArray<uint8>& GetEdgeDistances() const { return EdgeDistances; }
+	const TArray<FPlanetBiome>& GetPalette() const { return Palette; }
+	int32 GetMaxEdgeDistance() const { return MaxEdgeDistance; }
+	bool HasEdgeDistance() const { return EdgeDistances.Num() > 0; }
+
+	// UVs wrap horizontally and clamp vertically, matching the spherical layout of the 2D render target.
+	uint8 SampleNearest(float U, float V) const;
+	// Radius in texels, clamped to [0, 8]
+	uint8 SampleMajority(float U, float V, int32 Radius) const;
+	// 0 on a biome border, 1 at MaxDistance texels or further away from one.
+	float SampleEdgeDistance(float U, float V) const;
+
+	const FPlanetBiome* GetBiome(uint8 Index) const { return Palette.IsValidIndex(Index) ? &Palette[Index] : nullptr; }
+
+	int64 GetAllocatedSize() const { return Indices.GetAllocatedSize() + EdgeDistances.GetAllocatedSize() + Palette.GetAllocatedSize(); }
+
+private:
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	int32 MaxEdgeDistance = 0;
+	TArray<uint8> Indices;
+	TArray<uint8> EdgeDistances;
+	TArray<FPlanetBiome> Palette;
+
+	int32 GetTexelIndex(int32 X, int32 Y) const
+	{
+		X = ((X % SizeX) + SizeX) % SizeX;
+		Y = FMath::Clamp(Y, 0, SizeY - 1);
+		return Y * SizeX + X;
+	}
+	void UVToTexel(float U, float V, int32& OutX, int32& OutY) const
+	{
+		OutX = FMath::FloorToInt(U * SizeX);
+		OutY = FMath::FloorToInt(V * SizeY);
+	}
+};
+
+USTRUCT(BlueprintType)
+struct CUBEMAPPING01_API FPlanetBiomeTexture
+{
+	GENERATED_BODY()
+public:
+	FPlanetBiomeTexture() {}
+	FPlanetBiomeTexture(const TVoxelSharedRef<const FPlanetBiomeTextureData>& InData) : Data(InData) {}
+
+	bool IsValid() const { return Data.IsValid() && Data->GetSizeX() > 0 && Data->GetSizeY() > 0; }
+	const TVoxelSharedPtr<const FPlanetBiomeTextureData>& GetData() const { return Data; }
+
+private:
+	TVoxelSharedPtr<const FPlanetBiomeTextureData> Data;
+};
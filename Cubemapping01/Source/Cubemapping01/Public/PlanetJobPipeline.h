@@ -0,0 +1,123 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Containers/Queue.h"
+#include "PlanetJobPipeline.generated.h"
+
+/**
+ * Dependency based task scheduler for planet generation. A job is one planet, its tasks are the
+ * stages (create, render, readback, convert, register). Tasks of different jobs interleave so one planet
+ * can be read back on the game thread while another one is being converted in the background.
+ * It has no engine dependencies besides the task graph, pass a synchronous executor to drive it headless.
+ */
+
+UENUM(BlueprintType)
+enum class EPlanetJobState : uint8
+{
+	Queued,
+	Running,
+	Succeeded,
+	Failed,
+	Cancelled
+};
+
+enum class EPlanetJobThread : uint8
+{
+	GameThread,
+	AnyThread
+};
+
+struct FPlanetTaskContext
+{
+	int32 JobId = INDEX_NONE;
+	int32 TaskId = INDEX_NONE;
+	TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> bCancelled;
+
+	// Long running tasks should poll this and bail out early
+	bool IsCancelled() const { return bCancelled.IsValid() && *bCancelled; }
+};
+
+class CUBEMAPPING01_API FPlanetJobPipeline
+{
+public:
+	// Returns false if the task failed, the rest of the job is cancelled in that case
+	using FTaskFunction = TFunction<bool(const FPlanetTaskContext&)>;
+	using FExecutor = TFunction<void(TFunction<void()>)>;
+	using FOnJobCompleted = TFunction<void(int32, EPlanetJobState)>;
+
+	// By default AnyThread tasks run on the background task graph threads
+	explicit FPlanetJobPipeline(FExecutor InBackgroundExecutor = nullptr, int32 InMaxBackgroundTasks = 2);
+	~FPlanetJobPipeline();
+
+	// Higher priority runs first, it can be changed at any time (eg. from the distance to the camera)
+	int32 CreateJob(float Priority, FOnJobCompleted OnCompleted = nullptr);
+	// Dependencies are task ids returned by AddTask, from any job, whose job hasn't completed yet.
+	// Returns INDEX_NONE if a dependency is unknown. A task depending on a failed or cancelled task is cancelled.
+	int32 AddTask(int32 JobId, FName Name, EPlanetJobThread Thread, FTaskFunction Work, const TArray<int32>& Dependencies = {});
+
+	void SetPriority(int32 JobId, float Priority);
+	// Pending tasks are dropped, running ones are flagged and their result is discarded
+	void CancelJob(int32 JobId);
+	void CancelAll();
+
+	// Game thread only. Collects finished background tasks, then runs up to MaxGameThreadTasks ready game thread tasks
+	// and dispatches ready background tasks, both in priority order.
+	void Tick(int32 MaxGameThreadTasks);
+
+	// Finished jobs are forgotten once their completion callback ran
+	bool GetJobState(int32 JobId, EPlanetJobState& OutState) const;
+	int32 GetNumJobs() const { return Jobs.Num(); }
+	bool IsIdle() const { return Jobs.Num() == 0; }
+
+private:
+	enum class ETaskState : uint8
+	{
+		Pending,
+		Running,
+		Succeeded,
+		Failed,
+		Cancelled
+	};
+
+	struct FTask
+	{
+		int32 JobId = INDEX_NONE;
+		FName Name;
+		EPlanetJobThread Thread = EPlanetJobThread::GameThread;
+		FTaskFunction Work;
+		TArray<int32> Dependencies;
+		ETaskState State = ETaskState::Pending;
+	};
+
+	struct FJob
+	{
+		float Priority = 0.f;
+		TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> bCancelled;
+		TArray<int32> Tasks;
+		FOnJobCompleted OnCompleted;
+	};
+
+	using FCompletionQueue = TQueue<TPair<int32, bool>, EQueueMode::Mpsc>;
+
+	FExecutor BackgroundExecutor;
+	int32 MaxBackgroundTasks = 2;
+	int32 NumRunningBackgroundTasks = 0;
+	TSharedRef<FCompletionQueue, ESPMode::ThreadSafe> Completions;
+
+	int32 NextJobId = 1;
+	int32 NextTaskId = 1;
+	TMap<int32, FJob> Jobs;
+	TMap<int32, FTask> Tasks;
+
+	static bool IsFinished(ETaskState State) { return State == ETaskState::Succeeded || State == ETaskState::Failed || State == ETaskState::Cancelled; }
+
+	int32 FindNextReadyTask(bool bGameThreadAllowed, bool bBackgroundAllowed);
+	void RunTask(int32 TaskId);
+	void FinishTask(int32 TaskId, bool bSuccess);
+	void CancelDependents(int32 TaskId);
+	EPlanetJobState ComputeJobState(const FJob& Job) const;
+	void RemoveFinishedJobs();
+};
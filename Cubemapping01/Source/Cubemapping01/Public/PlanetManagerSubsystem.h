@@ -4,6 +4,9 @@
 
 #include "CoreMinimal.h"
 #include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FiveFunctionLibrary.h"
+#include "PlanetJobPipeline.h"
 #include "PlanetManagerSubsystem.generated.h"
 
 /**
@@ -48,19 +51,79 @@ public:
 	FRenderTargetSlot(UTextureRenderTarget2D* InTexture) : Texture(InTexture) { bValid = true; }
 };
 
+USTRUCT(BlueprintType)
+struct FPlanetGenerationRequest
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		FString CubemapKey;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		FString TextureKey;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		int32 Width = 1024;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		EVoxelRGBA Channel = EVoxelRGBA::R;
+};
+
+// Renders the noise into the resource render targets, return false to fail the job
+DECLARE_DYNAMIC_DELEGATE_RetVal_OneParam(bool, FPlanetRenderDelegate, FPlanetResource, Resource);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnPlanetJobCompleted, int32, JobId, EPlanetJobState, State);
+
 UCLASS()
-class CUBEMAPPING01_API UPlanetManagerSubsystem : public UWorldSubsystem
+class CUBEMAPPING01_API UPlanetManagerSubsystem : public UWorldSubsystem, public FTickableGameObject
 {
 	GENERATED_BODY()
 public:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
+
+	//~ Begin FTickableGameObject Interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual bool IsTickableWhenPaused() const override { return true; }
+	virtual TStatId GetStatId() const override;
+	//~ End FTickableGameObject Interface
 public:
 	UFUNCTION(BlueprintCallable)
 		void SetupTexturesIfNot(FRenderTargetConfig Config);
+
+	/* Planet generation jobs: create resource -> render -> readback -> build (background) -> deduplicate -> convert (background, skipped for known content) -> register in the caches.
+	   A request for a TextureKey that is still being generated cancels the older job. */
+	UFUNCTION(BlueprintCallable, Category = "Planet Jobs")
+		int32 RequestPlanet(FPlanetGenerationRequest Request, float Priority, FPlanetRenderDelegate Render);
+	// eg. -DistanceToCamera, so the closest planet is prepared first
+	UFUNCTION(BlueprintCallable, Category = "Planet Jobs")
+		void SetPlanetPriority(int32 JobId, float Priority);
+	UFUNCTION(BlueprintCallable, Category = "Planet Jobs")
+		void CancelPlanet(int32 JobId);
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Planet Jobs")
+		bool GetPlanetJobState(int32 JobId, EPlanetJobState& State) const;
+
+	using FRenderStage = TFunction<bool(const FPlanetResource&)>;
+	using FReadbackStage = TFunction<bool(const FPlanetResource&, int32& OutSizeX, int32& OutSizeY, TArray<FColor>& OutPixels)>;
+	// Render and readback can be replaced, eg. by a stand-in supplying the pixels when running without a renderer (null RHI).
+	// A null Readback reads the resource render target.
+	int32 RequestPlanetWithStages(const FPlanetGenerationRequest& Request, float Priority, FRenderStage Render, FReadbackStage Readback = nullptr);
+	// Replaces the background executor, only while no job is pending. Pass a synchronous one to run the jobs headless.
+	void SetPipelineExecutor(FPlanetJobPipeline::FExecutor Executor);
+	// Debug, number of planets whose colour data was actually converted (not reused from an identical planet)
+	int32 GetNumChannelConversions() const { return NumChannelConversions; }
+
+	UPROPERTY(BlueprintAssignable, Category = "Planet Jobs")
+		FOnPlanetJobCompleted OnPlanetJobCompleted;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Planet Jobs")
+		int32 MaxGameThreadTasksPerFrame = 2;
 private:
 	bool bInitialized = false;
 
+	TUniquePtr<FPlanetJobPipeline> Pipeline;
+	// Requests of the jobs that haven't completed yet
+	TMap<int32, FPlanetGenerationRequest> ActiveJobs;
+	int32 NumChannelConversions = 0;
+
+	bool IsCubemapInUse(const FString& CubemapKey) const;
+
 	// index - lod - extra
 	TMap<FIntVector, FRenderTargetSlot> RenderTargetStorage;
 
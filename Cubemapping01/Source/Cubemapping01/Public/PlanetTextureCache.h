@@ -0,0 +1,169 @@
+// Copyright (C) SquarerFive. 2019 - 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelTexture.h"
+#include "VoxelSharedPtr.h"
+#include "PlanetBiomeTexture.h"
+
+/**
+ * Content hashing for texture data, so identical planets (same seed, moons, instances) share one copy.
+ */
+
+CUBEMAPPING01_API uint64 HashPlanetTextureData(const TVoxelTexture<FColor>::FTextureData& Data);
+CUBEMAPPING01_API uint64 HashPlanetTextureData(const TVoxelTexture<float>::FTextureData& Data);
+CUBEMAPPING01_API uint64 HashPlanetTextureData(const FPlanetBiomeTextureData& Data);
+
+CUBEMAPPING01_API bool ArePlanetTextureDataEqual(const TVoxelTexture<FColor>::FTextureData& A, const TVoxelTexture<FColor>::FTextureData& B);
+CUBEMAPPING01_API bool ArePlanetTextureDataEqual(const TVoxelTexture<float>::FTextureData& A, const TVoxelTexture<float>::FTextureData& B);
+CUBEMAPPING01_API bool ArePlanetTextureDataEqual(const FPlanetBiomeTextureData& A, const FPlanetBiomeTextureData& B);
+
+/**
+ * Weak set of texture data bucketed by content hash. The caches own the data, the pool only
+ * hands out an existing identical copy when new data is inserted, so memory is freed with the last owner.
+ * Data must not be edited while pooled, call Remove first (see MakeUnique).
+ */
+template<typename TData>
+class TPlanetTextureContentPool
+{
+public:
+	TVoxelSharedRef<TData> FindOrAdd(const TVoxelSharedRef<TData>& Data)
+	{
+		return FindOrAdd(Data, HashPlanetTextureData(*Data));
+	}
+
+	// Hash must be HashPlanetTextureData(*Data), it can be computed off the game thread
+	TVoxelSharedRef<TData> FindOrAdd(const TVoxelSharedRef<TData>& Data, uint64 Hash)
+	{
+		if (++NumInsertsSincePrune >= PruneInterval)
+		{
+			Prune();
+		}
+
+		TArray<const TData*>& Bucket = Buckets.FindOrAdd(Hash);
+		for (int32 Index = Bucket.Num() - 1; Index >= 0; Index--)
+		{
+			const TVoxelSharedPtr<TData> Existing = PinEntry(Bucket[Index], Hash);
+			if (!Existing.IsValid())
+			{
+				Bucket.RemoveAtSwap(Index);
+				continue;
+			}
+			if (Existing == Data || ArePlanetTextureDataEqual(*Existing, *Data))
+			{
+				return Existing.ToSharedRef();
+			}
+		}
+		Bucket.Add(&Data.Get());
+		Entries.Add(&Data.Get(), { Hash, Data });
+		return Data;
+	}
+
+	bool IsPooled(const TVoxelSharedRef<TData>& Data) const
+	{
+		const FEntry* Entry = Entries.Find(&Data.Get());
+		return Entry && Entry->Data.Pin() == Data;
+	}
+
+	// Doesn't rehash the data, the hash it was pooled with is kept
+	void Remove(const TVoxelSharedRef<TData>& Data)
+	{
+		if (!IsPooled(Data))
+		{
+			return;
+		}
+		const uint64 Hash = Entries.FindAndRemoveChecked(&Data.Get()).Hash;
+		TArray<const TData*>& Bucket = Buckets.FindChecked(Hash);
+		Bucket.RemoveSingleSwap(&Data.Get());
+		if (Bucket.Num() == 0)
+		{
+			Buckets.Remove(Hash);
+		}
+	}
+
+	/**
+	 * Copy-on-write: before editing the data owned by a cache slot, make sure nobody else sees the edit.
+	 * Shared data is cloned into the slot and stays pooled for the other owners, data with a single owner
+	 * is edited in place. bOutRemovedFromPool is only set the first time, once the slot owns unpooled data
+	 * further edits are free.
+	 */
+	TVoxelSharedRef<TData> MakeUnique(TVoxelSharedPtr<TData>& Slot, bool& bOutRemovedFromPool)
+	{
+		check(Slot.IsValid());
+		const TVoxelSharedRef<TData> Data = Slot.ToSharedRef();
+		bOutRemovedFromPool = false;
+		// Slot and Data both hold a reference
+		if (Data.GetSharedReferenceCount() > 2)
+		{
+			Slot = MakeVoxelShared<TData>(*Data);
+		}
+		else if (IsPooled(Data))
+		{
+			Remove(Data);
+			bOutRemovedFromPool = true;
+		}
+		return Slot.ToSharedRef();
+	}
+
+	// Drops the entries of freed data and the buckets left empty
+	void Prune()
+	{
+		NumInsertsSincePrune = 0;
+		for (auto It = Buckets.CreateIterator(); It; ++It)
+		{
+			const uint64 Hash = It.Key();
+			It.Value().RemoveAllSwap([&](const TData* Pointer) { return !PinEntry(Pointer, Hash).IsValid(); });
+			if (It.Value().Num() == 0)
+			{
+				It.RemoveCurrent();
+			}
+		}
+		// Entries whose bucket was dropped above
+		for (auto It = Entries.CreateIterator(); It; ++It)
+		{
+			if (!It.Value().Data.IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	void Empty()
+	{
+		Buckets.Empty();
+		Entries.Empty();
+		NumInsertsSincePrune = 0;
+	}
+
+private:
+	struct FEntry
+	{
+		uint64 Hash = 0;
+		TVoxelWeakPtr<TData> Data;
+	};
+
+	static constexpr int32 PruneInterval = 64;
+
+	// Hash -> pooled data. Freed data leaves stale pointers behind, they are resolved through Entries.
+	TMap<uint64, TArray<const TData*>> Buckets;
+	TMap<const TData*, FEntry> Entries;
+	int32 NumInsertsSincePrune = 0;
+
+	// Null if the data was freed. Its address may be reused by new data pooled under another hash,
+	// the stale bucket pointer then doesn't resolve anymore.
+	TVoxelSharedPtr<TData> PinEntry(const TData* Pointer, uint64 Hash)
+	{
+		const FEntry* Entry = Entries.Find(Pointer);
+		if (!Entry || Entry->Hash != Hash)
+		{
+			return nullptr;
+		}
+		const TVoxelSharedPtr<TData> Data = Entry->Data.Pin();
+		if (!Data.IsValid())
+		{
+			Entries.Remove(Pointer);
+		}
+		return Data;
+	}
+};